@@ -135,6 +135,7 @@ void setStaticStressParams(Buffer &stressParams, map<string, int> stress_params,
   stressParams.store<uint32_t>(8, test_params["permuteLocation"]);
   stressParams.store<uint32_t>(9, stress_params["testingWorkgroups"]);
   stressParams.store<uint32_t>(10, stress_params["memStride"]);
+  stressParams.store<uint32_t>(11, stress_params["instancesPerThread"]);
 }
 
 /** Returns a value between the min and max. */
@@ -154,7 +155,7 @@ void run(string test_name, string &shader_file, string &result_shader_file, map<
   auto instance = Instance(enable_validation_layers);
   auto device = getDevice(instance, device_id);
   int testingThreads = stress_params["workgroupSize"] * stress_params["testingWorkgroups"];
-  int testLocSize = testingThreads * stress_params["memStride"];
+  int testLocSize = testingThreads * stress_params["instancesPerThread"] * stress_params["memStride"];
 
   // set up buffers
   vector<Buffer> buffers;
@@ -176,7 +177,7 @@ void run(string test_name, string &shader_file, string &result_shader_file, map<
   buffers.push_back(scratchpad);
   auto scratchLocations = Buffer(device, stress_params["maxWorkgroups"], sizeof(uint32_t));
   buffers.push_back(scratchLocations);
-  auto stressParams = Buffer(device, 11, sizeof(uint32_t));
+  auto stressParams = Buffer(device, 12, sizeof(uint32_t));
   setStaticStressParams(stressParams, stress_params, test_params);
   buffers.push_back(stressParams);
   resultBuffers.push_back(stressParams);
@@ -199,14 +200,15 @@ void run(string test_name, string &shader_file, string &result_shader_file, map<
     setDynamicStressParams(stressParams, stress_params);
 
     program.setWorkgroups(numWorkgroups);
-    resultProgram.setWorkgroups(stress_params["testingWorkgroups"]);
+    resultProgram.setWorkgroups(stress_params["testingWorkgroups"] * stress_params["instancesPerThread"]);
     program.setWorkgroupSize(stress_params["workgroupSize"]);
     resultProgram.setWorkgroupSize(stress_params["workgroupSize"]);
 
-    // workgroup memory shaders use workgroup memory for testing
+    // workgroup memory shaders use workgroup memory for testing, indexed only within the workgroup
     if (test_params["workgroupMemory"] == 1) {
-      program.setWorkgroupMemoryLength(testLocSize*sizeof(uint32_t), 0);
-      program.setWorkgroupMemoryLength(testLocSize*sizeof(uint32_t), 1);
+      int workgroupLocSize = stress_params["workgroupSize"] * stress_params["instancesPerThread"] * stress_params["memStride"];
+      program.setWorkgroupMemoryLength(workgroupLocSize*sizeof(uint32_t), 0);
+      program.setWorkgroupMemoryLength(workgroupLocSize*sizeof(uint32_t), 1);
     }
 
     program.initialize("run_test");
@@ -342,6 +344,10 @@ int main(int argc, char *argv[])
 
   srand(time(NULL));
   map<string, int> stressParams = read_config(stressParamsFile);
+  // configs without instancesPerThread run a single instance of the test in each thread
+  if (stressParams["instancesPerThread"] < 1) {
+    stressParams["instancesPerThread"] = 1;
+  }
   map<string, int> testParams = read_config(testParamsFile);
 //  for (const auto& [key, value] : stressParams) {
 //    std::cout << key << " = " << value << "; ";
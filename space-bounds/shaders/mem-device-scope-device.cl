@@ -60,9 +60,6 @@ __kernel void run_test (
     uint id_0 = shuffled_workgroup * get_local_size(0) +  get_local_id(0);
     uint new_workgroup = stripe_workgroup(shuffled_workgroup, get_local_id(0), stress_params[9]);
     uint id_1 = new_workgroup * get_local_size(0) + permute_id(get_local_id(0), stress_params[7], get_local_size(0));
-    uint x_0 = id_0 * stress_params[10]; // used to write to location x (thread 0)
-    uint y_0 = id_0 * stress_params[10]; // used to write to location y (thread 0)
-    uint x_1 = id_1 * stress_params[10]; // used to write to location x (thread 1)
     if (stress_params[4]) {
       do_stress(scratchpad, scratch_locations, stress_params[5], stress_params[6]);
     }
@@ -70,14 +67,20 @@ __kernel void run_test (
       spin(_barrier, get_local_size(0));
     }
 
-    // Thread 1
-    x_locations[x_1] = 1;
-
-    // Thread 0
-    uint a = stress_params[8];
-    x_locations[x_0] = a + 10;
-    y_locations[y_0] = a + 10;
+    // each instance runs on its own range of test locations, laid out one after another
+    for (uint instance = 0; instance < stress_params[11]; instance++) {
+      uint offset = instance * total_ids;
+      uint x_0 = (offset + id_0) * stress_params[10]; // used to write to location x (thread 0)
+      uint y_0 = (offset + id_0) * stress_params[10]; // used to write to location y (thread 0)
+      uint x_1 = (offset + id_1) * stress_params[10]; // used to write to location x (thread 1)
+      // Thread 1
+      x_locations[x_1] = 1;
 
+      // Thread 0
+      uint a = stress_params[8];
+      x_locations[x_0] = a + 10;
+      y_locations[y_0] = a + 10;
+    }
   } else if (stress_params[1]) {
     do_stress(scratchpad, scratch_locations, stress_params[2], stress_params[3]);
   }
@@ -6,5 +6,14 @@ LOCAL_MODULE    := runner
 LOCAL_C_INCLUDES := ../easyvk/src
 LOCAL_SRC_FILES := runner.cpp ../easyvk/src/easyvk.cpp
 LOCAL_LDLIBS    += -lvulkan -llog
+# routes easyvk's device creation through __wrap_vkCreateDevice in runner.cpp
+LOCAL_LDFLAGS   += -Wl,--wrap=vkCreateDevice
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE    := monitor
+LOCAL_SRC_FILES := monitor.cpp
 
 include $(BUILD_EXECUTABLE)
@@ -0,0 +1,200 @@
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// changes with the segment layout, so segments left from an older layout are rejected rather than misread
+#define AGGREGATE_MAGIC 0x62647262
+#define AGGREGATE_SLOTS 1024
+#define AGGREGATE_OUTCOMES 16
+#define AGGREGATE_NAME_LENGTH 64
+#define AGGREGATE_CONFIG_LENGTH 512
+// slots no runner has published to for this long may be reclaimed for new configs
+#define AGGREGATE_STALE_SECONDS 60
+
+#define SLOT_FREE 0
+#define SLOT_CLAIMED 1
+#define SLOT_READY 2
+
+static_assert(atomic<uint64_t>::is_always_lock_free, "aggregate counters must be lock-free to live in shared memory");
+
+/** Outcome counters for one test and config. A slot is claimed by the first runner to publish that test and config, and
+ *  its names are only read once state is SLOT_READY. Runners of the same test and config share the slot. Once the
+ *  segment is full, the least recently updated stale slot is reclaimed for the next new config; its generation is
+ *  bumped each time, so readers and runners holding the slot can tell it now belongs to another config.
+ */
+struct AggregateSlot {
+  atomic<uint32_t> state;
+  atomic<uint32_t> generation;
+  uint64_t configHash;
+  char testName[AGGREGATE_NAME_LENGTH];
+  char shader[AGGREGATE_NAME_LENGTH];
+  char config[AGGREGATE_CONFIG_LENGTH];
+  atomic<uint64_t> iterations;
+  atomic<uint64_t> violations;
+  atomic<uint64_t> outcomes[AGGREGATE_OUTCOMES];
+  atomic<uint64_t> lastUpdate; // seconds since the epoch
+};
+
+/** The shared memory segment that runners on this host publish to. It lives in a file mapped by every process, normally
+ *  under /dev/shm so it is never written back to disk. The counters of reclaimed slots are kept in the evicted totals,
+ *  and runs that found no slot to publish to are counted in unpublished.
+ */
+struct AggregateSegment {
+  atomic<uint32_t> magic;
+  atomic<uint64_t> evictions;
+  atomic<uint64_t> evictedIterations;
+  atomic<uint64_t> evictedViolations;
+  atomic<uint64_t> unpublished;
+  AggregateSlot slots[AGGREGATE_SLOTS];
+};
+
+/** A runner's claim on the slot for its test and config. The claim is stale once the slot's generation changes. */
+struct AggregateClaim {
+  AggregateSegment *segment;
+  string testName;
+  string shader;
+  string config;
+  AggregateSlot *slot;
+  uint32_t generation;
+};
+
+/** Maps the segment at the given path, creating and sizing it if needed. Returns nullptr if it cannot be mapped. */
+AggregateSegment* openAggregate(string &path, bool read_only) {
+  int fd = read_only ? open(path.c_str(), O_RDONLY) : open(path.c_str(), O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  // a new file is zero filled, which leaves every slot free
+  if (fstat(fd, &st) != 0 || (st.st_size < (off_t) sizeof(AggregateSegment) && (read_only || ftruncate(fd, sizeof(AggregateSegment)) != 0))) {
+    close(fd);
+    return nullptr;
+  }
+  void *mem = mmap(nullptr, sizeof(AggregateSegment), read_only ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mem == MAP_FAILED) {
+    return nullptr;
+  }
+  AggregateSegment *segment = (AggregateSegment*) mem;
+  uint32_t expected = 0;
+  if (!read_only) {
+    segment->magic.compare_exchange_strong(expected, AGGREGATE_MAGIC);
+  }
+  if (segment->magic.load() != AGGREGATE_MAGIC) {
+    munmap(mem, sizeof(AggregateSegment));
+    return nullptr;
+  }
+  return segment;
+}
+
+/** FNV-1a hash, used to match runners publishing the same test and config. */
+uint64_t aggregateHash(string &s) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : s) {
+    hash = (hash ^ (uint8_t) c) * 1099511628211ull;
+  }
+  return hash;
+}
+
+/** Flattens a config into the "key=value" pairs shown by the monitor. */
+string aggregateConfig(map<string, int> &config) {
+  string flat;
+  for (const auto& [key, value] : config) {
+    flat += (flat.empty() ? "" : " ") + key + "=" + to_string(value);
+  }
+  return flat;
+}
+
+/** Writes a config's names into a slot held in SLOT_CLAIMED, starting its counters from zero, and publishes it. */
+void fillAggregateSlot(AggregateSlot &slot, uint64_t hash, AggregateClaim &claim) {
+  slot.configHash = hash;
+  strncpy(slot.testName, claim.testName.c_str(), AGGREGATE_NAME_LENGTH - 1);
+  strncpy(slot.shader, claim.shader.c_str(), AGGREGATE_NAME_LENGTH - 1);
+  strncpy(slot.config, claim.config.c_str(), AGGREGATE_CONFIG_LENGTH - 1);
+  slot.iterations.store(0, memory_order_relaxed);
+  slot.violations.store(0, memory_order_relaxed);
+  for (int i = 0; i < AGGREGATE_OUTCOMES; i++) {
+    slot.outcomes[i].store(0, memory_order_relaxed);
+  }
+  slot.lastUpdate.store(time(NULL), memory_order_relaxed);
+  slot.generation.fetch_add(1, memory_order_release);
+  slot.state.store(SLOT_READY, memory_order_release);
+}
+
+/** Claims the slot for the claim's test and config: the slot another runner already publishes it to, a free slot, or
+ *  failing those the least recently updated slot that has gone stale. Returns false, and counts the run as unpublished,
+ *  if every slot has been updated within AGGREGATE_STALE_SECONDS.
+ */
+bool claimAggregateSlot(AggregateClaim &claim) {
+  string key = claim.testName + "\n" + claim.shader + "\n" + claim.config;
+  uint64_t hash = aggregateHash(key);
+  AggregateSegment *segment = claim.segment;
+  for (int i = 0; i < AGGREGATE_SLOTS; i++) {
+    AggregateSlot &slot = segment->slots[i];
+    uint32_t generation = slot.generation.load(memory_order_acquire);
+    uint32_t state = slot.state.load(memory_order_acquire);
+    if (state == SLOT_READY && slot.configHash == hash && slot.generation.load(memory_order_acquire) == generation) {
+      claim.slot = &slot;
+      claim.generation = generation;
+      return true;
+    }
+    if (state == SLOT_FREE && slot.state.compare_exchange_strong(state, SLOT_CLAIMED, memory_order_acquire)) {
+      fillAggregateSlot(slot, hash, claim);
+      claim.slot = &slot;
+      claim.generation = slot.generation.load(memory_order_relaxed);
+      return true;
+    }
+  }
+  // the segment is full, so reclaim the least recently updated slot if no runner has published to it in a while
+  while (true) {
+    uint64_t oldest = time(NULL) - AGGREGATE_STALE_SECONDS;
+    AggregateSlot *victim = nullptr;
+    for (int i = 0; i < AGGREGATE_SLOTS; i++) {
+      AggregateSlot &slot = segment->slots[i];
+      uint64_t lastUpdate = slot.lastUpdate.load(memory_order_relaxed);
+      if (slot.state.load(memory_order_acquire) == SLOT_READY && lastUpdate < oldest) {
+        oldest = lastUpdate;
+        victim = &slot;
+      }
+    }
+    if (victim == nullptr) {
+      segment->unpublished.fetch_add(1, memory_order_relaxed);
+      claim.slot = nullptr;
+      return false;
+    }
+    uint32_t state = SLOT_READY;
+    if (victim->state.compare_exchange_strong(state, SLOT_CLAIMED, memory_order_acquire)) {
+      segment->evictions.fetch_add(1, memory_order_relaxed);
+      segment->evictedIterations.fetch_add(victim->iterations.load(memory_order_relaxed), memory_order_relaxed);
+      segment->evictedViolations.fetch_add(victim->violations.load(memory_order_relaxed), memory_order_relaxed);
+      fillAggregateSlot(*victim, hash, claim);
+      claim.slot = victim;
+      claim.generation = victim->generation.load(memory_order_relaxed);
+      return true;
+    }
+  }
+}
+
+/** Adds one iteration's outcomes to the claimed slot. Only relaxed atomic increments while the claim holds, so it is safe
+ *  to call on the hot path. If the slot went stale and was reclaimed for another config, the runner claims a slot again
+ *  first, and stops publishing if none is left.
+ */
+void publishIteration(AggregateClaim *claim, vector<uint32_t> &results, int violations) {
+  if (claim->slot == nullptr) {
+    return;
+  }
+  if (claim->slot->generation.load(memory_order_acquire) != claim->generation && !claimAggregateSlot(*claim)) {
+    return;
+  }
+  AggregateSlot *slot = claim->slot;
+  for (size_t i = 0; i < results.size() && i < AGGREGATE_OUTCOMES; i++) {
+    slot->outcomes[i].fetch_add(results[i], memory_order_relaxed);
+  }
+  slot->violations.fetch_add(violations, memory_order_relaxed);
+  slot->iterations.fetch_add(1, memory_order_relaxed);
+  slot->lastUpdate.store(time(NULL), memory_order_relaxed);
+}
@@ -46,3 +46,37 @@ int check_results(vector<uint32_t> results, string test_name) {
   }
   return false;
 }
+
+/** Skew between the racy accesses of the two threads in each pair, in device clock ticks.
+ *  Bucket 0 counts pairs with no skew, and bucket b counts skews in [2^(b-1), 2^b).
+ */
+struct SkewHistogram {
+  vector<uint64_t> buckets = vector<uint64_t>(33, 0);
+  uint64_t thread0First = 0;
+  uint64_t thread1First = 0;
+};
+
+void print_skew(SkewHistogram &skew) {
+  uint64_t total = 0;
+  for (uint64_t count : skew.buckets) {
+    total += count;
+  }
+  cout << "Skew histogram (thread 0 first: " << skew.thread0First << ", thread 1 first: " << skew.thread1First << ")\n";
+  uint64_t seen = 0;
+  uint64_t median = 0;
+  for (size_t b = 0; b < skew.buckets.size(); b++) {
+    if (seen < (total + 1) / 2 && seen + skew.buckets[b] >= (total + 1) / 2) {
+      median = b == 0 ? 0 : (1ull << b) - 1;
+    }
+    seen += skew.buckets[b];
+    if (skew.buckets[b] == 0) {
+      continue;
+    }
+    if (b == 0) {
+      cout << "skew=0: " << skew.buckets[b] << "\n";
+    } else {
+      cout << "skew=[" << (1ull << (b - 1)) << ", " << (1ull << b) << "): " << skew.buckets[b] << "\n";
+    }
+  }
+  cout << "Median skew at most: " << median << "\n\n";
+}
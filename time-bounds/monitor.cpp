@@ -0,0 +1,171 @@
+#include <map>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <ctime>
+#include <unistd.h>
+#include "aggregate.h"
+
+using namespace std;
+
+/** Counters for one test and config, combined across every slot runners have published them to. */
+struct ConfigTotals {
+  string testName;
+  string shader;
+  string config;
+  uint64_t iterations = 0;
+  uint64_t violations = 0;
+  uint64_t lastUpdate = 0;
+  double iterationsPerSec = 0;
+};
+
+/** Reads the counters of every ready slot in the segment, keyed by test and config. Slots reclaimed for another config
+ *  while being read are skipped until the next reading.
+ */
+map<uint64_t, ConfigTotals> readTotals(AggregateSegment *segment) {
+  map<uint64_t, ConfigTotals> totals;
+  for (int i = 0; i < AGGREGATE_SLOTS; i++) {
+    AggregateSlot &slot = segment->slots[i];
+    uint32_t generation = slot.generation.load(memory_order_acquire);
+    if (slot.state.load(memory_order_acquire) != SLOT_READY) {
+      continue;
+    }
+    ConfigTotals t;
+    uint64_t hash = slot.configHash;
+    t.testName = string(slot.testName, strnlen(slot.testName, AGGREGATE_NAME_LENGTH));
+    t.shader = string(slot.shader, strnlen(slot.shader, AGGREGATE_NAME_LENGTH));
+    t.config = string(slot.config, strnlen(slot.config, AGGREGATE_CONFIG_LENGTH));
+    t.iterations = slot.iterations.load(memory_order_relaxed);
+    t.violations = slot.violations.load(memory_order_relaxed);
+    t.lastUpdate = slot.lastUpdate.load(memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (slot.state.load(memory_order_relaxed) != SLOT_READY || slot.generation.load(memory_order_relaxed) != generation) {
+      continue;
+    }
+    ConfigTotals &merged = totals[hash];
+    merged.testName = t.testName;
+    merged.shader = t.shader;
+    merged.config = t.config;
+    merged.iterations += t.iterations;
+    merged.violations += t.violations;
+    merged.lastUpdate = max(merged.lastUpdate, t.lastUpdate);
+  }
+  return totals;
+}
+
+/** Counters across the whole segment, including configs whose slots have been reclaimed. */
+struct SegmentTotals {
+  uint64_t iterations = 0;
+  uint64_t violations = 0;
+};
+
+/** Prints combined throughput and violations, followed by the configs with the most violations. Rates are computed from
+ *  the change in iterations since the previous reading.
+ */
+void printTotals(AggregateSegment *segment, map<uint64_t, ConfigTotals> &totals, map<uint64_t, ConfigTotals> &previous, SegmentTotals &previousSegment, double interval, int top) {
+  vector<ConfigTotals> configs;
+  SegmentTotals segmentTotals;
+  segmentTotals.iterations = segment->evictedIterations.load(memory_order_relaxed);
+  segmentTotals.violations = segment->evictedViolations.load(memory_order_relaxed);
+  int active = 0;
+  uint64_t now = time(NULL);
+  for (auto& [hash, t] : totals) {
+    if (previous.count(hash) && t.iterations >= previous[hash].iterations) {
+      t.iterationsPerSec = (t.iterations - previous[hash].iterations) / interval;
+    }
+    segmentTotals.iterations += t.iterations;
+    segmentTotals.violations += t.violations;
+    active += now - t.lastUpdate <= 2 * interval + 1 ? 1 : 0;
+    configs.push_back(t);
+  }
+  sort(configs.begin(), configs.end(), [](const ConfigTotals &a, const ConfigTotals &b) {
+    return a.violations != b.violations ? a.violations > b.violations : a.iterationsPerSec > b.iterationsPerSec;
+  });
+  // a slot caught mid-reclaim drops out of one reading, so the combined count can briefly go backwards
+  double totalPerSec = 0;
+  if (segmentTotals.iterations >= previousSegment.iterations) {
+    totalPerSec = (segmentTotals.iterations - previousSegment.iterations) / interval;
+  }
+  previousSegment = segmentTotals;
+
+  cout << "Configs: " << totals.size() << " of " << AGGREGATE_SLOTS << " slots (active: " << active << ", evicted: " << segment->evictions.load(memory_order_relaxed) << ")\n";
+  uint64_t unpublished = segment->unpublished.load(memory_order_relaxed);
+  if (unpublished > 0) {
+    cout << "Segment full: " << unpublished << " runs could not publish\n";
+  }
+  cout << "Iterations: " << segmentTotals.iterations << " (" << totalPerSec << "/sec)\n";
+  cout << "Violations: " << segmentTotals.violations << "\n\n";
+  for (int i = 0; i < top && i < (int) configs.size(); i++) {
+    ConfigTotals &t = configs[i];
+    cout << t.testName << " " << t.shader << " violations: " << t.violations << " iterations: " << t.iterations << " (" << t.iterationsPerSec << "/sec)\n";
+    cout << "  " << t.config << "\n";
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  string aggregateFile;
+  double interval = 1;
+  int top = 10;
+  bool once = false;
+
+  int c;
+  while ((c = getopt(argc, argv, "om:i:k:")) != -1)
+    switch (c)
+    {
+    case 'm':
+      aggregateFile = optarg;
+      break;
+    case 'i':
+      interval = atof(optarg);
+      break;
+    case 'k':
+      top = atoi(optarg);
+      break;
+    case 'o':
+      once = true;
+      break;
+    case '?':
+      if (optopt == 'm' || optopt == 'i' || optopt == 'k')
+        std::cerr << "Option -" << optopt << "requires an argument\n";
+      else
+        std::cerr << "Unknown option" << optopt << "\n";
+      return 1;
+    default:
+      abort();
+    }
+
+  if (aggregateFile.empty()) {
+    std::cerr << "Aggregate segment (-m) must be set\n";
+    return 1;
+  }
+
+  AggregateSegment *segment = openAggregate(aggregateFile, true);
+  if (segment == nullptr) {
+    std::cerr << "Could not open aggregate segment " << aggregateFile << "\n";
+    return 1;
+  }
+
+  map<uint64_t, ConfigTotals> previous = readTotals(segment);
+  SegmentTotals previousSegment;
+  previousSegment.iterations = segment->evictedIterations.load(memory_order_relaxed);
+  for (auto& [hash, t] : previous) {
+    previousSegment.iterations += t.iterations;
+  }
+  while (true) {
+    this_thread::sleep_for(chrono::duration<double>(interval));
+    map<uint64_t, ConfigTotals> totals = readTotals(segment);
+    if (!once) {
+      cout << "\033[2J\033[H";
+    }
+    printTotals(segment, totals, previous, previousSegment, interval, top);
+    if (once) {
+      break;
+    }
+    previous = totals;
+  }
+  return 0;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <map>
 #include <set>
 #include <iostream>
@@ -5,13 +6,27 @@
 #include <sstream>
 #include <fstream>
 #include <chrono>
+#include <random>
+#include <cmath>
+#include <climits>
+#include <cstring>
 #include <easyvk.h>
 #include <unistd.h>
 #include "checker.h"
+#include "sampler.h"
+#include "aggregate.h"
 
 using namespace std;
 using namespace easyvk;
 
+// config generation limits when no device profile is given
+#define DEFAULT_WORKGROUP_LIMIT 1024
+#define DEFAULT_WORKGROUP_SIZE_LIMIT 256
+// calibration stops doubling the testing threads once a step gains less than this factor in throughput
+#define SATURATION_GAIN 1.1
+// upper bound on testing threads during calibration, to keep buffer sizes reasonable
+#define MAX_CALIBRATION_THREADS (1 << 22)
+
 /** Returns the GPU to use for this test run. Users can specify the specific GPU to use
  *  with the a device index parameter. If the index is too large, an error is returned.
  */
@@ -31,6 +46,55 @@ void listDevices() {
   }
 }
 
+/** Returns whether a device supports reading the device clock in shaders, which skew instrumentation needs. */
+bool supportsShaderDeviceClock(VkPhysicalDevice physical_device) {
+  uint32_t numExtensions = 0;
+  vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &numExtensions, nullptr);
+  vector<VkExtensionProperties> extensions(numExtensions);
+  vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &numExtensions, extensions.data());
+  bool found = false;
+  for (VkExtensionProperties &extension : extensions) {
+    found = found || strcmp(extension.extensionName, VK_KHR_SHADER_CLOCK_EXTENSION_NAME) == 0;
+  }
+  if (!found) {
+    return false;
+  }
+  VkPhysicalDeviceShaderClockFeaturesKHR clockFeatures = {};
+  clockFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CLOCK_FEATURES_KHR;
+  VkPhysicalDeviceFeatures2 features = {};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  features.pNext = &clockFeatures;
+  vkGetPhysicalDeviceFeatures2(physical_device, &features);
+  return clockFeatures.shaderDeviceClock == VK_TRUE;
+}
+
+// set before creating a device that runs skew shaders, so device creation enables the device clock
+static bool enableShaderDeviceClock = false;
+
+extern "C" VKAPI_ATTR VkResult VKAPI_CALL __real_vkCreateDevice(VkPhysicalDevice physical_device, const VkDeviceCreateInfo *create_info, const VkAllocationCallbacks *allocator, VkDevice *device);
+
+/** easyvk creates devices without a way to add extensions or features, so the runner is linked with
+ *  --wrap=vkCreateDevice and easyvk's call lands here instead. When enableShaderDeviceClock is set it adds
+ *  VK_KHR_shader_clock and enables shaderDeviceClock, then calls the loader's vkCreateDevice, which the linker binds to
+ *  __real_vkCreateDevice. Check supportsShaderDeviceClock before setting the flag.
+ */
+extern "C" VKAPI_ATTR VkResult VKAPI_CALL __wrap_vkCreateDevice(VkPhysicalDevice physical_device, const VkDeviceCreateInfo *create_info, const VkAllocationCallbacks *allocator, VkDevice *device) {
+  if (!enableShaderDeviceClock) {
+    return __real_vkCreateDevice(physical_device, create_info, allocator, device);
+  }
+  VkDeviceCreateInfo info = *create_info;
+  vector<const char*> extensions(info.ppEnabledExtensionNames, info.ppEnabledExtensionNames + info.enabledExtensionCount);
+  extensions.push_back(VK_KHR_SHADER_CLOCK_EXTENSION_NAME);
+  info.enabledExtensionCount = extensions.size();
+  info.ppEnabledExtensionNames = extensions.data();
+  VkPhysicalDeviceShaderClockFeaturesKHR clockFeatures = {};
+  clockFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CLOCK_FEATURES_KHR;
+  clockFeatures.pNext = (void*) info.pNext;
+  clockFeatures.shaderDeviceClock = VK_TRUE;
+  info.pNext = &clockFeatures;
+  return __real_vkCreateDevice(physical_device, &info, allocator, device);
+}
+
 /** Zeroes out the specified buffer. */
 void clearMemory(Buffer &gpuMem, int size) {
   for (int i = 0; i < size; i++) {
@@ -123,6 +187,7 @@ void setStaticStressParams(Buffer &stressParams, map<string, int> stress_params,
   stressParams.store<uint32_t>(8, test_params["permuteLocation"]);
   stressParams.store<uint32_t>(9, stress_params["testingWorkgroups"]);
   stressParams.store<uint32_t>(10, stress_params["memStride"]);
+  stressParams.store<uint32_t>(11, stress_params["instancesPerThread"]);
 }
 
 /** Returns a value between the min and max. */
@@ -135,14 +200,69 @@ int setBetween(int min, int max) {
   }
 }
 
-/** A test consists of N iterations of a shader and its corresponding result shader. */
-void run(string test_name, string &shader_file, string &result_shader_file, map<string, int> stress_params, map<string, int> test_params, int device_id, bool enable_validation_layers)
+/** Returns the number of 32-bit words of workgroup memory each test location array needs. Workgroup memory tests only
+ *  index locations within their own workgroup, so this does not grow with the number of testing workgroups.
+ */
+int workgroupMemoryWords(map<string, int> stress_params) {
+  return stress_params["workgroupSize"] * stress_params["memStride"] * stress_params["instancesPerThread"];
+}
+
+/** Checks a config against the device's compute limits, so configs that would fail to launch are reported instead of run. */
+bool withinDeviceLimits(Device &device, map<string, int> stress_params, map<string, int> test_params) {
+  auto limits = device.properties.limits;
+  if ((uint32_t) stress_params["maxWorkgroups"] > limits.maxComputeWorkGroupCount[0]) {
+    std::cerr << "maxWorkgroups " << stress_params["maxWorkgroups"] << " exceeds device limit " << limits.maxComputeWorkGroupCount[0] << "\n";
+    return false;
+  }
+  // the result shader checks each instance in its own thread
+  if ((uint32_t) (stress_params["testingWorkgroups"] * stress_params["instancesPerThread"]) > limits.maxComputeWorkGroupCount[0]) {
+    std::cerr << "Result shader workgroups " << stress_params["testingWorkgroups"] * stress_params["instancesPerThread"] << " exceed device limit " << limits.maxComputeWorkGroupCount[0] << "\n";
+    return false;
+  }
+  if ((uint32_t) stress_params["workgroupSize"] > limits.maxComputeWorkGroupSize[0] || (uint32_t) stress_params["workgroupSize"] > limits.maxComputeWorkGroupInvocations) {
+    std::cerr << "workgroupSize " << stress_params["workgroupSize"] << " exceeds device limit " << limits.maxComputeWorkGroupSize[0] << "\n";
+    return false;
+  }
+  // workgroup memory shaders use two test location arrays, one non-atomic and one atomic
+  if (test_params["workgroupMemory"] == 1 && 2 * workgroupMemoryWords(stress_params) * sizeof(uint32_t) > limits.maxComputeSharedMemorySize) {
+    std::cerr << "Workgroup memory of " << 2 * workgroupMemoryWords(stress_params) * sizeof(uint32_t) << " bytes exceeds device limit " << limits.maxComputeSharedMemorySize << "\n";
+    return false;
+  }
+  return true;
+}
+
+/** Adds the skew between the racy accesses of each pair of threads to the histogram. Pairs where either thread did not
+ *  record a time are skipped.
+ */
+void accumulateSkew(Buffer &timestamps, int num_pairs, SkewHistogram &skew) {
+  for (int i = 0; i < num_pairs; i++) {
+    uint32_t t0 = timestamps.load<uint32_t>(2 * i);
+    uint32_t t1 = timestamps.load<uint32_t>(1 + 2 * i);
+    if (t0 == 0 || t1 == 0) {
+      continue;
+    }
+    // clock readings are truncated to 32 bits, so take the difference modulo 2^32
+    int32_t diff = (int32_t) (t1 - t0);
+    uint32_t magnitude = diff < 0 ? -(uint32_t) diff : diff;
+    int bucket = 0;
+    while (bucket < 32 && (magnitude >> bucket) != 0) {
+      bucket++;
+    }
+    skew.buckets[bucket]++;
+    if (diff < 0) {
+      skew.thread1First++;
+    } else if (diff > 0) {
+      skew.thread0First++;
+    }
+  }
+}
+
+/** Runs N iterations of a shader and its corresponding result shader on the given device, returning the number of violations. */
+int runIterations(Device &device, string test_name, string &shader_file, string &result_shader_file, map<string, int> stress_params, map<string, int> test_params, bool record_skew, AggregateClaim *aggregate)
 {
-  // initialize settings
-  auto instance = Instance(enable_validation_layers);
-  auto device = getDevice(instance, device_id);
   int testingThreads = stress_params["workgroupSize"] * stress_params["testingWorkgroups"];
-  int testLocSize = testingThreads * stress_params["memStride"];
+  int testInstances = testingThreads * stress_params["instancesPerThread"];
+  int testLocSize = testInstances * stress_params["memStride"];
 
   // set up buffers
   vector<Buffer> buffers;
@@ -158,7 +278,7 @@ void run(string test_name, string &shader_file, string &result_shader_file, map<
     buffers.push_back(Buffer(device, testLocSize, sizeof(uint32_t))); // atomic test locations
   }
 
-  auto readResults = Buffer(device, test_params["numOutputs"] * testingThreads, sizeof(uint32_t));
+  auto readResults = Buffer(device, test_params["numOutputs"] * testInstances, sizeof(uint32_t));
   buffers.push_back(readResults);
   resultBuffers.push_back(readResults);
 
@@ -173,15 +293,21 @@ void run(string test_name, string &shader_file, string &result_shader_file, map<
   buffers.push_back(scratchpad);
   auto scratchLocations = Buffer(device, stress_params["maxWorkgroups"], sizeof(uint32_t));
   buffers.push_back(scratchLocations);
-  auto stressParams = Buffer(device, 11, sizeof(uint32_t));
+  auto stressParams = Buffer(device, 12, sizeof(uint32_t));
   setStaticStressParams(stressParams, stress_params, test_params);
   buffers.push_back(stressParams);
   resultBuffers.push_back(stressParams);
 
+  // instrumented shaders record the device clock when both threads of each pair reach their racy accesses
+  int skewIndex = buffers.size();
+  int numSkewSlots = 2 * testInstances;
+  SkewHistogram skew;
+  if (record_skew) {
+    buffers.push_back(Buffer(device, numSkewSlots, sizeof(uint32_t)));
+  }
+
 
   // run iterations
-  chrono::time_point<std::chrono::system_clock> start, end;
-  start = chrono::system_clock::now();
   int numViolations = 0;
   for (int i = 0; i < stress_params["testIterations"]; i++) {
     auto program = Program(device, shader_file.c_str(), buffers);
@@ -197,19 +323,22 @@ void run(string test_name, string &shader_file, string &result_shader_file, map<
     clearMemory(testResults, test_params["numResults"]);
     clearMemory(barrier, 1);
     clearMemory(scratchpad, stress_params["scratchMemorySize"]);
+    if (record_skew) {
+      clearMemory(buffers[skewIndex], numSkewSlots);
+    }
     setShuffledWorkgroups(shuffledWorkgroups, numWorkgroups, stress_params["shufflePct"]);
     setScratchLocations(scratchLocations, numWorkgroups, stress_params);
     setDynamicStressParams(stressParams, stress_params);
 
     program.setWorkgroups(numWorkgroups);
-    resultProgram.setWorkgroups(stress_params["testingWorkgroups"]);
+    resultProgram.setWorkgroups(stress_params["testingWorkgroups"] * stress_params["instancesPerThread"]);
     program.setWorkgroupSize(stress_params["workgroupSize"]);
     resultProgram.setWorkgroupSize(stress_params["workgroupSize"]);
 
     // workgroup memory shaders use workgroup memory for testing
     if (test_params["workgroupMemory"] == 1) {
-      program.setWorkgroupMemoryLength(testLocSize*sizeof(uint32_t), 0);
-      program.setWorkgroupMemoryLength(testLocSize*sizeof(uint32_t), 1);
+      program.setWorkgroupMemoryLength(workgroupMemoryWords(stress_params)*sizeof(uint32_t), 0);
+      program.setWorkgroupMemoryLength(workgroupMemoryWords(stress_params)*sizeof(uint32_t), 1);
     }
 
     program.initialize("run_test");
@@ -223,7 +352,14 @@ void run(string test_name, string &shader_file, string &result_shader_file, map<
     for (int i = 0; i < test_params["numResults"]; i++) {
       results.push_back(testResults.load<uint32_t>(i));
     }
-    numViolations += check_results(results, test_name);
+    int iterationViolations = check_results(results, test_name);
+    numViolations += iterationViolations;
+    if (aggregate != nullptr) {
+      publishIteration(aggregate, results, iterationViolations);
+    }
+    if (record_skew) {
+      accumulateSkew(buffers[skewIndex], testInstances, skew);
+    }
 
 //    for (int i = 0; i < testingThreads; i++) {
 //      cout << "i: " << i <<  " flag: " << readResults.load<uint32_t>(i*2) << " r0: " << readResults.load<uint32_t>(i*2 + 1) << " mem: " << buffers[0].load<uint32_t>(i*stress_params["memStride"]) << "\n";
@@ -233,14 +369,54 @@ void run(string test_name, string &shader_file, string &result_shader_file, map<
     resultProgram.teardown();
   }
 
-  cout << "Number of violations: " << numViolations << "\n";
+  if (record_skew) {
+    print_skew(skew);
+  }
 
   for (Buffer buffer : buffers) {
     buffer.teardown();
   }
   testResults.teardown();
+  return numViolations;
+}
+
+/** A test consists of N iterations of a shader and its corresponding result shader. Returns false without running the
+ *  test if the config exceeds the device's limits, or the shader needs a feature the device does not support.
+ */
+bool run(string test_name, string &shader_file, string &result_shader_file, map<string, int> stress_params, map<string, int> test_params, int device_id, bool enable_validation_layers, bool record_skew, string &aggregate_file)
+{
+  // initialize settings
+  auto instance = Instance(enable_validation_layers);
+  // skew shaders read the device clock, which has to be enabled when the device is created
+  if (record_skew) {
+    if (!supportsShaderDeviceClock(instance.physicalDevices().at(device_id))) {
+      std::cerr << "Skew shaders need VK_KHR_shader_clock with shaderDeviceClock, which the device does not support\n";
+      instance.teardown();
+      return false;
+    }
+    enableShaderDeviceClock = true;
+  }
+  auto device = getDevice(instance, device_id);
+  bool withinLimits = withinDeviceLimits(device, stress_params, test_params);
+  if (withinLimits) {
+    // publish outcomes to the shared memory segment, if aggregating results across runners; configs the device rejects
+    // never claim a slot
+    AggregateClaim claim = {nullptr, test_name, shader_file.substr(shader_file.find_last_of('/') + 1), aggregateConfig(stress_params), nullptr, 0};
+    AggregateClaim *aggregate = nullptr;
+    if (!aggregate_file.empty()) {
+      claim.segment = openAggregate(aggregate_file, false);
+      if (claim.segment != nullptr && claimAggregateSlot(claim)) {
+        aggregate = &claim;
+      } else {
+        std::cerr << "Could not publish to aggregate segment " << aggregate_file << "\n";
+      }
+    }
+    int numViolations = runIterations(device, test_name, shader_file, result_shader_file, stress_params, test_params, record_skew, aggregate);
+    cout << "Number of violations: " << numViolations << "\n";
+  }
   device.teardown();
   instance.teardown();
+  return withinLimits;
 }
 
 /** Reads a specified config file and stores the parameters in a map. Parameters should be of the form "key=value", one per line. */
@@ -265,6 +441,62 @@ map<string, int> read_config(string &config_file)
   return m;
 }
 
+/** Writes the parameters in a map to the specified config file, in the same "key=value" form read by read_config. */
+void write_config(string &config_file, map<string, int> &m)
+{
+  ofstream out_file(config_file);
+  for (const auto& [key, value] : m) {
+    out_file << key << "=" << value << "\n";
+  }
+}
+
+/** Returns whether a shader was built with skew instrumentation, which the Makefile marks with a -skew.spv suffix. */
+bool isSkewShader(string &shader_file) {
+  string suffix = "-skew.spv";
+  return shader_file.size() >= suffix.size() && shader_file.compare(shader_file.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/** Queries the device's compute limits and measures the number of testing threads at which iteration throughput
+ *  saturates, by doubling the number of testing workgroups until throughput stops improving. The limits and the
+ *  saturation point are written to the profile file, which bounds config generation for this device.
+ */
+void calibrate(string test_name, string &shader_file, string &result_shader_file, map<string, int> stress_params, map<string, int> test_params, int device_id, bool enable_validation_layers, string &profile_file)
+{
+  auto instance = Instance(enable_validation_layers);
+  auto device = getDevice(instance, device_id);
+  auto limits = device.properties.limits;
+  map<string, int> profile;
+  // some drivers report limits up to UINT32_MAX, which would wrap in the profile's int values
+  profile["maxWorkgroupCount"] = min<uint32_t>(limits.maxComputeWorkGroupCount[0], INT_MAX);
+  profile["maxWorkgroupSize"] = min<uint32_t>(min(limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations), INT_MAX);
+  profile["maxSharedMemorySize"] = min<uint32_t>(limits.maxComputeSharedMemorySize, INT_MAX);
+
+  stress_params["workgroupSize"] = min(stress_params["workgroupSize"], profile["maxWorkgroupSize"]);
+  double bestThroughput = 0;
+  int saturationThreads = 2 * stress_params["workgroupSize"];
+  for (int workgroups = 2; workgroups <= profile["maxWorkgroupCount"] && workgroups * stress_params["workgroupSize"] <= MAX_CALIBRATION_THREADS; workgroups *= 2) {
+    stress_params["testingWorkgroups"] = workgroups;
+    stress_params["maxWorkgroups"] = workgroups;
+    chrono::time_point<std::chrono::system_clock> start = chrono::system_clock::now();
+    runIterations(device, test_name, shader_file, result_shader_file, stress_params, test_params, false, nullptr);
+    chrono::duration<double> elapsed = chrono::system_clock::now() - start;
+    double throughput = (double) workgroups * stress_params["workgroupSize"] * stress_params["instancesPerThread"] * stress_params["testIterations"] / elapsed.count();
+    cout << "Testing threads: " << workgroups * stress_params["workgroupSize"] << " samples/sec: " << throughput << "\n";
+    // doubling the threads should roughly double throughput until the device is full
+    if (throughput < bestThroughput * SATURATION_GAIN) {
+      break;
+    }
+    bestThroughput = throughput;
+    saturationThreads = workgroups * stress_params["workgroupSize"];
+  }
+  profile["saturationThreads"] = saturationThreads;
+  write_config(profile_file, profile);
+  cout << "Saturation at " << saturationThreads << " testing threads\n";
+
+  device.teardown();
+  instance.teardown();
+}
+
 int main(int argc, char *argv[])
 {
 
@@ -273,12 +505,18 @@ int main(int argc, char *argv[])
   string stressParamsFile;
   string testParamsFile;
   string testName;
+  string coverageFile;
+  string profileFile;
+  string calibrationFile;
+  string aggregateFile;
+  int workgroupLimit = 0;
+  int workgroupSizeLimit = 0;
   int deviceIndex = 0;
   bool enableValidationLayers = false;
   bool list_devices = false;
 
   int c;
-  while ((c = getopt(argc, argv, "vcls:r:p:t:d:n:")) != -1)
+  while ((c = getopt(argc, argv, "vcls:r:p:t:d:n:g:w:z:D:a:m:")) != -1)
     switch (c)
     {
     case 'n':
@@ -305,6 +543,24 @@ int main(int argc, char *argv[])
     case 'd':
       deviceIndex = atoi(optarg);
       break;
+    case 'g':
+      coverageFile = optarg;
+      break;
+    case 'w':
+      workgroupLimit = atoi(optarg);
+      break;
+    case 'z':
+      workgroupSizeLimit = atoi(optarg);
+      break;
+    case 'D':
+      profileFile = optarg;
+      break;
+    case 'a':
+      calibrationFile = optarg;
+      break;
+    case 'm':
+      aggregateFile = optarg;
+      break;
     case '?':
       if (optopt == 's' || optopt == 'r' || optopt == 'p')
         std::cerr << "Option -" << optopt << "requires an argument\n";
@@ -320,6 +576,47 @@ int main(int argc, char *argv[])
     return 0;
   }
 
+  // generate the next config in the sequence tracked by the coverage file, instead of running a test
+  if (!coverageFile.empty()) {
+    if (stressParamsFile.empty()) {
+      std::cerr << "Stress param file (-p) must be set\n";
+      return 1;
+    }
+    // limits come from the device profile if there is one, with -w and -z as optional caps
+    ConfigLimits limits = {DEFAULT_WORKGROUP_LIMIT, DEFAULT_WORKGROUP_SIZE_LIMIT, 0, 0};
+    if (!profileFile.empty()) {
+      map<string, int> profile = read_config(profileFile);
+      for (string key : {"maxWorkgroupCount", "maxWorkgroupSize", "maxSharedMemorySize", "saturationThreads"}) {
+        if (profile[key] <= 0) {
+          std::cerr << "Device profile " << profileFile << " has no positive " << key << ", calibrate the device again (-a)\n";
+          return 1;
+        }
+      }
+      limits.workgroupLimit = profile["maxWorkgroupCount"];
+      limits.workgroupSizeLimit = profile["maxWorkgroupSize"];
+      limits.saturationThreads = profile["saturationThreads"];
+      if (!testParamsFile.empty() && read_config(testParamsFile)["workgroupMemory"] == 1) {
+        limits.workgroupMemoryWords = profile["maxSharedMemorySize"] / sizeof(uint32_t);
+      }
+    }
+    if (workgroupLimit > 0) {
+      limits.workgroupLimit = profileFile.empty() ? workgroupLimit : min(limits.workgroupLimit, workgroupLimit);
+    }
+    if (workgroupSizeLimit > 0) {
+      limits.workgroupSizeLimit = profileFile.empty() ? workgroupSizeLimit : min(limits.workgroupSizeLimit, workgroupSizeLimit);
+    }
+    if (limits.workgroupLimit < 2 || limits.workgroupSizeLimit < 1) {
+      std::cerr << "Workgroup limit must be at least 2 and workgroup size limit at least 1\n";
+      return 1;
+    }
+    map<string, int> coverage = read_config(coverageFile);
+    map<string, int> config = generateConfig(coverage, limits);
+    write_config(stressParamsFile, config);
+    write_config(coverageFile, coverage);
+    printCoverage(coverage);
+    return 0;
+  }
+
   if (testName.empty()) {
     std::cerr << "Test name (-n) must be set\n";
     return 1;
@@ -347,11 +644,27 @@ int main(int argc, char *argv[])
 
   srand(time(NULL));
   map<string, int> stressParams = read_config(stressParamsFile);
+  // configs without instancesPerThread run a single instance of the test in each thread
+  if (stressParams["instancesPerThread"] < 1) {
+    stressParams["instancesPerThread"] = 1;
+  }
   map<string, int> testParams = read_config(testParamsFile);
 //  for (const auto& [key, value] : stressParams) {
 //    std::cout << key << " = " << value << "; ";
 //  }
 //  std::cout << "\n";
-  run(testName, shaderFile, resultShaderFile, stressParams, testParams, deviceIndex, enableValidationLayers);
+  // the Makefile's skew target builds instrumented shaders, which take an extra buffer for the timestamps
+  bool recordSkew = isSkewShader(shaderFile);
+  if (!calibrationFile.empty()) {
+    if (recordSkew) {
+      std::cerr << "Calibration must use a shader without skew instrumentation\n";
+      return 1;
+    }
+    calibrate(testName, shaderFile, resultShaderFile, stressParams, testParams, deviceIndex, enableValidationLayers, calibrationFile);
+  } else {
+    if (!run(testName, shaderFile, resultShaderFile, stressParams, testParams, deviceIndex, enableValidationLayers, recordSkew, aggregateFile)) {
+      return 1;
+    }
+  }
   return 0;
 }
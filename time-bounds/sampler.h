@@ -0,0 +1,323 @@
+using namespace std;
+
+#define SOBOL_BITS 32
+// dimensions of the Sobol sequence used for each group of knobs
+#define SOBOL_DIMS 4
+#define COVERAGE_BINS 8
+// bins per knob in the joint coverage of pairs of knobs
+#define JOINT_BINS 4
+// generated configs use at most this multiple of the testing threads at which the device saturates
+#define SATURATION_HEADROOM 2
+
+/** Direction numbers for dimensions 2 to SOBOL_DIMS of the Sobol sequence (Joe and Kuo). Each entry holds the degree s
+ *  of the primitive polynomial, its encoded coefficients a, and the initial direction numbers m_1..m_s. Dimension 1 is
+ *  the van der Corput sequence and needs no entry.
+ */
+struct SobolDirection {
+  int s;
+  int a;
+  uint32_t m[3];
+};
+
+static const SobolDirection sobolDirections[] = {
+  {1, 0, {1}},
+  {2, 1, {1, 3}},
+  {3, 1, {1, 3, 1}}
+};
+
+/** Returns the scaled direction numbers v_1..v_32 for the given (zero based) dimension. */
+vector<uint32_t> sobolDirectionNumbers(int dim) {
+  vector<uint32_t> v(SOBOL_BITS);
+  if (dim == 0) {
+    for (int i = 0; i < SOBOL_BITS; i++) {
+      v[i] = 1u << (SOBOL_BITS - 1 - i);
+    }
+    return v;
+  }
+  const SobolDirection &dir = sobolDirections[dim - 1];
+  for (int i = 0; i < dir.s; i++) {
+    v[i] = dir.m[i] << (SOBOL_BITS - 1 - i);
+  }
+  for (int i = dir.s; i < SOBOL_BITS; i++) {
+    v[i] = v[i - dir.s] ^ (v[i - dir.s] >> dir.s);
+    for (int k = 1; k < dir.s; k++) {
+      v[i] ^= ((dir.a >> (dir.s - 1 - k)) & 1) * v[i - k];
+    }
+  }
+  return v;
+}
+
+/** Reverses the bits of a 32 bit word. */
+uint32_t reverseBits(uint32_t x) {
+  x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+  x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+  x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+  x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+  return (x >> 16) | (x << 16);
+}
+
+/** Hash-based Owen scrambling of a Sobol coordinate (Burley, "Practical Hash-based Owen Scrambling"). Each seed gives a
+ *  different random permutation of the sequence that keeps its stratification.
+ */
+uint32_t owenScramble(uint32_t x, uint32_t seed) {
+  x = reverseBits(x);
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return reverseBits(x);
+}
+
+/** Derives an independent seed for the nth group or dimension from a seed. */
+uint32_t mixSeed(uint32_t seed, int n) {
+  uint32_t h = seed ^ ((uint32_t) (n + 1) * 0x9e3779b9u);
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return h;
+}
+
+/** Returns the point at the given index of a scrambled Sobol sequence, with every coordinate in [0, 1). Higher
+ *  dimensions of Sobol repeat the leading bits of lower ones, which makes them strongly correlated over short prefixes,
+ *  so coordinates are drawn in groups of SOBOL_DIMS from the first dimensions of the sequence. Each group gets its own
+ *  scramble and visits the points in its own shuffled order (Burley's padding). Scrambling the index keeps every
+ *  aligned block of 2^k indices together, so any prefix of 2^k points is still evenly spread over each coordinate.
+ */
+vector<double> sobolPoint(uint32_t index, int num_dims, uint32_t seed) {
+  vector<double> point;
+  for (int group = 0; (int) point.size() < num_dims; group++) {
+    uint32_t groupSeed = mixSeed(seed, group);
+    uint32_t shuffled = owenScramble(index, groupSeed);
+    uint32_t gray = shuffled ^ (shuffled >> 1);
+    for (int dim = 0; dim < SOBOL_DIMS && (int) point.size() < num_dims; dim++) {
+      vector<uint32_t> v = sobolDirectionNumbers(dim);
+      uint32_t x = 0;
+      for (int bit = 0; bit < SOBOL_BITS; bit++) {
+        if ((gray >> bit) & 1) {
+          x ^= v[bit];
+        }
+      }
+      point.push_back((double) owenScramble(x, mixSeed(groupSeed, dim)) / 4294967296.0);
+    }
+  }
+  return point;
+}
+
+/** A tunable parameter, sampled uniformly between min and max (inclusive). Knobs with a log scale are sampled, and
+ *  their coverage binned, evenly in log space instead.
+ */
+struct Knob {
+  string name;
+  int min;
+  int max;
+  bool logScale = false;
+};
+
+/** Knobs whose pairwise joint coverage is tracked: the workgroup knobs, which set how many threads race, and the knobs
+ *  that set how hard the stressing threads work.
+ */
+static const vector<string> jointKnobs = {
+  "testingWorkgroups", "workgroupSize", "memStressPct", "memStressIterations", "preStressPct", "preStressIterations"
+};
+
+/** Bounds on generated configs. With a saturation point, the range of workgroups is scaled so testing threads stay
+ *  within SATURATION_HEADROOM times the point at which the device is full. With a workgroup memory size, the workgroup
+ *  size is bounded so the test locations fit in each workgroup's shared memory. Either bound is unused when 0.
+ */
+struct ConfigLimits {
+  int workgroupLimit;
+  int workgroupSizeLimit;
+  int saturationThreads;
+  int workgroupMemoryWords;
+};
+
+/** Returns the most workgroups a config can use at a workgroup size, so testing threads stay within the saturation
+ *  headroom.
+ */
+int workgroupCap(ConfigLimits limits, int workgroup_size) {
+  if (limits.saturationThreads > 0) {
+    return clamp(SATURATION_HEADROOM * limits.saturationThreads / workgroup_size, 2, limits.workgroupLimit);
+  }
+  return limits.workgroupLimit;
+}
+
+/** The knobs sampled for each config, in the order they consume dimensions of the sequence. The workgroup knobs are
+ *  listed with the widest ranges the limits allow; generateConfig narrows them per config. stressLineSize is drawn as
+ *  its square root.
+ */
+vector<Knob> configKnobs(ConfigLimits limits) {
+  int workgroupLimit = workgroupCap(limits, 1);
+  int workgroupSizeLimit = limits.workgroupSizeLimit;
+  if (limits.workgroupMemoryWords > 0) {
+    workgroupSizeLimit = clamp(limits.workgroupMemoryWords / 2, 1, limits.workgroupSizeLimit);
+  }
+  return {
+    {"testingWorkgroups", 2, workgroupLimit, true},
+    {"maxWorkgroups", 2, workgroupLimit, true},
+    {"workgroupSize", 1, workgroupSizeLimit},
+    {"shufflePct", 0, 100},
+    {"barrierPct", 0, 100},
+    {"stressLineSize", 2, 10},
+    {"stressTargetLines", 1, 16},
+    {"memStride", 1, 7},
+    {"memStressPct", 0, 100},
+    {"memStressIterations", 0, 1024},
+    {"memStressPattern", 0, 3},
+    {"preStressPct", 0, 100},
+    {"preStressIterations", 0, 128},
+    {"preStressPattern", 0, 3},
+    {"stressAssignmentStrategy", 0, 1},
+    {"instancesPerThread", 1, 8}
+  };
+}
+
+/** Maps a coordinate in [0, 1) to an integer between min and max (inclusive). */
+int scaleToRange(double u, int min, int max) {
+  int value = min + (int) (u * (max - min + 1));
+  return value > max ? max : value;
+}
+
+/** Maps a coordinate in [0, 1) to an integer between min and max (inclusive), evenly in log space. min must be positive. */
+int scaleToLogRange(double u, int min, int max) {
+  int value = (int) (min * pow((double) (max + 1) / min, u));
+  return value > max ? max : (value < min ? min : value);
+}
+
+/** Draws a knob's value between min and max on the knob's scale, so draws fill its coverage bins evenly. */
+int drawKnob(const Knob &knob, double u, int min, int max) {
+  return knob.logScale ? scaleToLogRange(u, min, max) : scaleToRange(u, min, max);
+}
+
+/** Returns the number of coverage bins for a knob. Knobs with few values get one bin per value. */
+int coverageBins(const Knob &knob) {
+  return knob.max - knob.min + 1 < COVERAGE_BINS ? knob.max - knob.min + 1 : COVERAGE_BINS;
+}
+
+/** Returns which of the given number of bins a value falls in within a knob's range. */
+int coverageBin(const Knob &knob, int value, int bins) {
+  double position = (double) (value - knob.min) / (knob.max - knob.min + 1);
+  if (knob.logScale) {
+    position = log((double) value / knob.min) / log((double) (knob.max + 1) / knob.min);
+  }
+  int bin = (int) (position * bins);
+  return bin < 0 ? 0 : (bin >= bins ? bins - 1 : bin);
+}
+
+/** Returns the smallest value of a knob that falls in the given bin or a later one, or max + 1 if none does. */
+int binLowerBound(const Knob &knob, int bin, int bins) {
+  int lo = knob.min;
+  int hi = knob.max + 1;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (coverageBin(knob, mid, bins) >= bin) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+/** Returns whether any valid config falls in a joint cell of two knobs. Of the joint knobs, only testingWorkgroups and
+ *  workgroupSize constrain each other: past the saturation point, many workgroups are only allowed with small ones.
+ */
+bool jointCellFeasible(ConfigLimits limits, const Knob &a, int bin_a, const Knob &b, int bin_b) {
+  if (a.name != "testingWorkgroups" || b.name != "workgroupSize") {
+    return true;
+  }
+  int workgroupSize = binLowerBound(b, bin_b, JOINT_BINS);
+  return workgroupSize <= b.max && binLowerBound(a, bin_a, JOINT_BINS) <= workgroupCap(limits, workgroupSize);
+}
+
+/** Generates the next config in the Sobol sequence tracked by the coverage map and records the bin of each knob, and the
+ *  cell of each pair of joint knobs, that it covers. Derived parameters (scratchMemorySize) and constraints between parameters (maxWorkgroups >=
+ *  testingWorkgroups, device limits) are applied while sampling, so every generated config is valid.
+ */
+map<string, int> generateConfig(map<string, int> &coverage, ConfigLimits limits) {
+  vector<Knob> knobs = configKnobs(limits);
+  // each coverage file scrambles the sequence with its own seed, so devices tuned in parallel sample different points
+  if (!coverage.count("scrambleSeed")) {
+    coverage["scrambleSeed"] = (int) random_device()();
+  }
+  uint32_t sampleIndex = coverage["sampleIndex"];
+  vector<double> point = sobolPoint(sampleIndex, knobs.size(), (uint32_t) coverage["scrambleSeed"]);
+
+  map<string, int> config;
+  for (size_t i = 0; i < knobs.size(); i++) {
+    config[knobs[i].name] = drawKnob(knobs[i], point[i], knobs[i].min, knobs[i].max);
+  }
+  // workgroup memory tests need two arrays of workgroupSize * memStride * instancesPerThread words in each workgroup
+  if (limits.workgroupMemoryWords > 0) {
+    config["workgroupSize"] = scaleToRange(point[2], 1, clamp(limits.workgroupMemoryWords / (2 * config["memStride"] * config["instancesPerThread"]), 1, limits.workgroupSizeLimit));
+  }
+  int workgroupLimit = workgroupCap(limits, config["workgroupSize"]);
+  // the result shader dispatches testingWorkgroups * instancesPerThread workgroups
+  config["testingWorkgroups"] = drawKnob(knobs[0], point[0], 2, clamp(limits.workgroupLimit / config["instancesPerThread"], 2, workgroupLimit));
+  config["maxWorkgroups"] = drawKnob(knobs[1], point[1], config["testingWorkgroups"], workgroupLimit);
+  // coverage is binned against each knob's full range for the device, not the range narrowed for this config, so
+  // counts are comparable across configs. The workgroup knobs are drawn and binned on a log scale, since their narrowed
+  // ranges shrink as workgroupSize grows.
+  map<string, int> jointBins;
+  for (Knob &knob : knobs) {
+    coverage[knob.name + "." + to_string(coverageBin(knob, config[knob.name], coverageBins(knob)))]++;
+    jointBins[knob.name] = coverageBin(knob, config[knob.name], JOINT_BINS);
+  }
+  for (size_t a = 0; a < jointKnobs.size(); a++) {
+    for (size_t b = a + 1; b < jointKnobs.size(); b++) {
+      coverage[jointKnobs[a] + "." + jointKnobs[b] + "." + to_string(jointBins[jointKnobs[a]]) + "." + to_string(jointBins[jointKnobs[b]])]++;
+    }
+  }
+  coverage["sampleIndex"] = sampleIndex + 1;
+  coverage["workgroupLimit"] = limits.workgroupLimit;
+  coverage["workgroupSizeLimit"] = limits.workgroupSizeLimit;
+  coverage["saturationThreads"] = limits.saturationThreads;
+  coverage["workgroupMemoryWords"] = limits.workgroupMemoryWords;
+
+  config["stressLineSize"] = config["stressLineSize"] * config["stressLineSize"];
+  config["scratchMemorySize"] = 32 * config["stressLineSize"] * config["stressTargetLines"];
+  config["testIterations"] = 200;
+  config["permuteThread"] = 419;
+  return config;
+}
+
+/** Prints the least covered bin of each knob and the number of covered cells for each pair of joint knobs, out of the
+ *  cells a valid config can fall in, so gaps in coverage are easy to spot.
+ */
+void printCoverage(map<string, int> &coverage) {
+  cout << "Configs generated: " << coverage["sampleIndex"] << "\n";
+  ConfigLimits limits = {coverage["workgroupLimit"], coverage["workgroupSizeLimit"], coverage["saturationThreads"], coverage["workgroupMemoryWords"]};
+  for (Knob knob : configKnobs(limits)) {
+    int minCount = coverage[knob.name + ".0"];
+    int emptyBins = 0;
+    for (int bin = 0; bin < coverageBins(knob); bin++) {
+      int count = coverage[knob.name + "." + to_string(bin)];
+      minCount = count < minCount ? count : minCount;
+      emptyBins += count == 0 ? 1 : 0;
+    }
+    cout << knob.name << " min bin count: " << minCount << " empty bins: " << emptyBins << "\n";
+  }
+  map<string, Knob> knobs;
+  for (Knob knob : configKnobs(limits)) {
+    knobs[knob.name] = knob;
+  }
+  for (size_t a = 0; a < jointKnobs.size(); a++) {
+    for (size_t b = a + 1; b < jointKnobs.size(); b++) {
+      int covered = 0;
+      int feasible = 0;
+      for (int i = 0; i < JOINT_BINS; i++) {
+        for (int j = 0; j < JOINT_BINS; j++) {
+          covered += coverage.count(jointKnobs[a] + "." + jointKnobs[b] + "." + to_string(i) + "." + to_string(j));
+          feasible += jointCellFeasible(limits, knobs[jointKnobs[a]], i, knobs[jointKnobs[b]], j) ? 1 : 0;
+        }
+      }
+      cout << jointKnobs[a] << " x " << jointKnobs[b] << " covered cells: " << covered << "/" << feasible;
+      if (feasible < JOINT_BINS * JOINT_BINS) {
+        cout << " (" << JOINT_BINS * JOINT_BINS - feasible << " infeasible)";
+      }
+      cout << "\n";
+    }
+  }
+}
@@ -45,6 +45,20 @@ static void do_stress(__global uint* scratchpad, __global uint* scratch_location
   }
 }
 
+#ifdef SKEW_INSTRUMENTATION
+// Records when a thread reaches its racy access, as the low bits of the device clock. Needs VK_KHR_shader_clock with
+// shaderDeviceClock enabled on the device.
+static void record_time(__global atomic_uint* timestamps, uint slot) {
+  atomic_store_explicit(&timestamps[slot], (uint) clock_read_device(), memory_order_relaxed);
+}
+
+#define SKEW_ARG , __global atomic_uint* skew_timestamps
+#define RECORD_TIME(slot) record_time(skew_timestamps, slot)
+#else
+#define SKEW_ARG
+#define RECORD_TIME(slot)
+#endif
+
 __kernel void run_test (
   __global uint* non_atomic_test_locations,
   __global atomic_uint* atomic_test_locations,
@@ -53,34 +67,40 @@ __kernel void run_test (
   __global atomic_uint* _barrier,
   __global uint* scratchpad,
   __global uint* scratch_locations,
-  __global uint* stress_params) {
+  __global uint* stress_params SKEW_ARG) {
   uint shuffled_workgroup = shuffled_workgroups[get_group_id(0)];
   if(shuffled_workgroup < stress_params[9]) {
     uint total_ids = get_local_size(0) ;
     uint id_0 = get_local_id(0);
     uint id_1 = permute_id(get_local_id(0), stress_params[7], get_local_size(0));
-    uint x_0 = (shuffled_workgroup * get_local_size(0) + id_0) * stress_params[10]; // used to write to the racy location and write the flag (thread 0)
-    uint x_1 = (shuffled_workgroup * get_local_size(0) + id_1) * stress_params[10]; // used to write to the racy location, read the flag, first read of racy location (thread 1)
-    uint y_1 = (shuffled_workgroup * get_local_size(0) + permute_id(id_1, stress_params[8], total_ids)) * stress_params[10]; // aliased second write to racy location (thread 1)
     if (stress_params[4]) {
       do_stress(scratchpad, scratch_locations, stress_params[5], stress_params[6]);
     }
     if (stress_params[0]) {
       spin(_barrier, get_local_size(0));
     }
-    // Thread 0
-    non_atomic_test_locations[x_0] = 1;
-    atomic_store_explicit(&atomic_test_locations[x_0], 1, memory_order_release);
+    // each instance runs on its own range of test locations, laid out one after another
+    for (uint instance = 0; instance < stress_params[11]; instance++) {
+      uint offset = instance * get_local_size(0) * stress_params[9];
+      uint x_0 = (offset + shuffled_workgroup * get_local_size(0) + id_0) * stress_params[10]; // used to write to the racy location and write the flag (thread 0)
+      uint x_1 = (offset + shuffled_workgroup * get_local_size(0) + id_1) * stress_params[10]; // used to write to the racy location, read the flag, first read of racy location (thread 1)
+      uint y_1 = (offset + shuffled_workgroup * get_local_size(0) + permute_id(id_1, stress_params[8], total_ids)) * stress_params[10]; // aliased second write to racy location (thread 1)
+      // Thread 0
+      RECORD_TIME(2 * (offset + shuffled_workgroup * get_local_size(0) + id_0));
+      non_atomic_test_locations[x_0] = 1;
+      atomic_store_explicit(&atomic_test_locations[x_0], 1, memory_order_release);
 
-    // Thread 1
-    non_atomic_test_locations[x_1] = 2;
-    uint flag = atomic_load_explicit(&atomic_test_locations[x_1], memory_order_acquire);
-    uint r0 = non_atomic_test_locations[x_1];
-    non_atomic_test_locations[y_1] = 3;
+      // Thread 1
+      RECORD_TIME(1 + 2 * (offset + shuffled_workgroup * get_local_size(0) + id_1));
+      non_atomic_test_locations[x_1] = 2;
+      uint flag = atomic_load_explicit(&atomic_test_locations[x_1], memory_order_acquire);
+      uint r0 = non_atomic_test_locations[x_1];
+      non_atomic_test_locations[y_1] = 3;
 
-    // Store back results for analysis
-    read_results[(shuffled_workgroup * get_local_size(0) + id_1) * 2] = flag;
-    read_results[(shuffled_workgroup* get_local_size(0) + id_1) * 2 + 1] = r0;
+      // Store back results for analysis
+      read_results[(offset + shuffled_workgroup * get_local_size(0) + id_1) * 2] = flag;
+      read_results[(offset + shuffled_workgroup* get_local_size(0) + id_1) * 2 + 1] = r0;
+    }
   } else if (stress_params[1]) {
     do_stress(scratchpad, scratch_locations, stress_params[2], stress_params[3]);
   }
@@ -45,6 +45,20 @@ static void do_stress(__global uint* scratchpad, __global uint* scratch_location
   }
 }
 
+#ifdef SKEW_INSTRUMENTATION
+// Records when a thread reaches its racy access, as the low bits of the device clock. Needs VK_KHR_shader_clock with
+// shaderDeviceClock enabled on the device.
+static void record_time(__global atomic_uint* timestamps, uint slot) {
+  atomic_store_explicit(&timestamps[slot], (uint) clock_read_device(), memory_order_relaxed);
+}
+
+#define SKEW_ARG , __global atomic_uint* skew_timestamps
+#define RECORD_TIME(slot) record_time(skew_timestamps, slot)
+#else
+#define SKEW_ARG
+#define RECORD_TIME(slot)
+#endif
+
 __kernel void run_test (
   __local uint* wg_non_atomic_test_locations,
   __local atomic_uint* wg_atomic_test_locations,
@@ -54,9 +68,11 @@ __kernel void run_test (
   __global atomic_uint* _barrier,
   __global uint* scratchpad,
   __global uint* scratch_locations,
-  __global uint* stress_params) {
-  wg_non_atomic_test_locations[get_local_id(0) * stress_params[10]] = 0; // local memory is not zero initialized by default
-  atomic_store_explicit(&wg_atomic_test_locations[get_local_id(0) * stress_params[10]], 0, memory_order_relaxed);
+  __global uint* stress_params SKEW_ARG) {
+  for (uint instance = 0; instance < stress_params[11]; instance++) {
+    wg_non_atomic_test_locations[(instance * get_local_size(0) + get_local_id(0)) * stress_params[10]] = 0; // local memory is not zero initialized by default
+    atomic_store_explicit(&wg_atomic_test_locations[(instance * get_local_size(0) + get_local_id(0)) * stress_params[10]], 0, memory_order_relaxed);
+  }
 
   barrier(CLK_LOCAL_MEM_FENCE); // ensure all threads in the workgroup see zero initialized memory
 
@@ -65,29 +81,36 @@ __kernel void run_test (
     uint total_ids = get_local_size(0) ;
     uint id_0 = get_local_id(0);
     uint id_1 = permute_id(get_local_id(0), stress_params[7], get_local_size(0));
-    uint x_0 = id_0 * stress_params[10]; // used to write to the racy location and write the flag (thread 0)
-    uint x_1 = id_1 * stress_params[10]; // used to write to the racy location, read the flag, first read of racy location (thread 1)
-    uint y_1 = permute_id(id_1, stress_params[8], total_ids) * stress_params[10]; // aliased second write to racy location (thread 1)
     if (stress_params[4]) {
       do_stress(scratchpad, scratch_locations, stress_params[5], stress_params[6]);
     }
     if (stress_params[0]) {
       spin(_barrier, get_local_size(0));
     }
-    // Thread 0
-    wg_non_atomic_test_locations[x_0] = 1;
-    atomic_store_explicit(&wg_atomic_test_locations[x_0], 1, memory_order_release);
+    // each instance runs on its own range of test locations, laid out one after another
+    for (uint instance = 0; instance < stress_params[11]; instance++) {
+      uint wg_offset = instance * total_ids;
+      uint offset = instance * get_local_size(0) * stress_params[9];
+      uint x_0 = (wg_offset + id_0) * stress_params[10]; // used to write to the racy location and write the flag (thread 0)
+      uint x_1 = (wg_offset + id_1) * stress_params[10]; // used to write to the racy location, read the flag, first read of racy location (thread 1)
+      uint y_1 = (wg_offset + permute_id(id_1, stress_params[8], total_ids)) * stress_params[10]; // aliased second write to racy location (thread 1)
+      // Thread 0
+      RECORD_TIME(2 * (offset + shuffled_workgroup * get_local_size(0) + id_0));
+      wg_non_atomic_test_locations[x_0] = 1;
+      atomic_store_explicit(&wg_atomic_test_locations[x_0], 1, memory_order_release);
 
-    // Thread 1
-    wg_non_atomic_test_locations[x_1] = 2;
-    uint flag = atomic_load_explicit(&wg_atomic_test_locations[x_1], memory_order_acquire);
-    uint r0 = wg_non_atomic_test_locations[x_1];
-    wg_non_atomic_test_locations[y_1] = 3;
+      // Thread 1
+      RECORD_TIME(1 + 2 * (offset + shuffled_workgroup * get_local_size(0) + id_1));
+      wg_non_atomic_test_locations[x_1] = 2;
+      uint flag = atomic_load_explicit(&wg_atomic_test_locations[x_1], memory_order_acquire);
+      uint r0 = wg_non_atomic_test_locations[x_1];
+      wg_non_atomic_test_locations[y_1] = 3;
 
-    // Store back results for analysis
-    read_results[(shuffled_workgroup * get_local_size(0) + id_1) * 2] = flag;
-    read_results[(shuffled_workgroup* get_local_size(0) + id_1) * 2 + 1] = r0;
-    non_atomic_test_locations[shuffled_workgroup * get_local_size(0) * stress_params[10] + x_1] = wg_non_atomic_test_locations[y_1];
+      // Store back results for analysis
+      read_results[(offset + shuffled_workgroup * get_local_size(0) + id_1) * 2] = flag;
+      read_results[(offset + shuffled_workgroup* get_local_size(0) + id_1) * 2 + 1] = r0;
+      non_atomic_test_locations[(offset + shuffled_workgroup * get_local_size(0) + id_1) * stress_params[10]] = wg_non_atomic_test_locations[y_1];
+    }
   } else if (stress_params[1]) {
     do_stress(scratchpad, scratch_locations, stress_params[2], stress_params[3]);
   }
@@ -2,51 +2,49 @@
 
 PARAM_FILE="params.txt"
 RESULT_DIR="results"
-
-# Generate a random number between min and max
-function random_between() {
-  local min=$1
-  local max=$2
-
-  local range=$((max - min + 1))
-  local random=$((RANDOM % range + min))
-  echo "$random"
+# set AGGREGATE to a shared memory path (e.g. /dev/shm/bounding-data-races) to publish results for ./monitor
+
+# Measure the device's compute limits and saturation point, which bound the configs generated for it
+function calibrate() {
+  echo "testIterations=10" > $PARAM_FILE
+  echo "testingWorkgroups=2" >> $PARAM_FILE
+  echo "maxWorkgroups=2" >> $PARAM_FILE
+  echo "workgroupSize=256" >> $PARAM_FILE
+  echo "shufflePct=0" >> $PARAM_FILE
+  echo "barrierPct=0" >> $PARAM_FILE
+  echo "stressLineSize=64" >> $PARAM_FILE
+  echo "stressTargetLines=1" >> $PARAM_FILE
+  echo "scratchMemorySize=2048" >> $PARAM_FILE
+  echo "memStride=1" >> $PARAM_FILE
+  echo "memStressPct=0" >> $PARAM_FILE
+  echo "memStressIterations=0" >> $PARAM_FILE
+  echo "memStressPattern=0" >> $PARAM_FILE
+  echo "preStressPct=0" >> $PARAM_FILE
+  echo "preStressIterations=0" >> $PARAM_FILE
+  echo "preStressPattern=0" >> $PARAM_FILE
+  echo "stressAssignmentStrategy=0" >> $PARAM_FILE
+  echo "permuteThread=419" >> $PARAM_FILE
+  echo "instancesPerThread=1" >> $PARAM_FILE
+  ./runner -a $PROFILE_FILE -n rr -s rr-mem-device-scope-device.spv -r rr-results.spv -p $PARAM_FILE -t rr-mem-device-params.txt -d $device_idx > /dev/null
 }
 
-function random_config() {
-  local workgroupLimiter=$1
-  local workgroupSizeLimiter=$2
-
-  echo "testIterations=200" > $PARAM_FILE
-  local testingWorkgroups=$(random_between 2 $workgroupLimiter)
-  echo "testingWorkgroups=$testingWorkgroups" >> $PARAM_FILE
-  local maxWorkgroups=$(random_between $testingWorkgroups $workgroupLimiter)
-  echo "maxWorkgroups=$maxWorkgroups" >> $PARAM_FILE
-  local workgroupSize=$(random_between 1 $workgroupSizeLimiter)
-  echo "workgroupSize=$workgroupSize" >> $PARAM_FILE
-  echo "shufflePct=$(random_between 0 100)" >> $PARAM_FILE
-  echo "barrierPct=$(random_between 0 100)" >> $PARAM_FILE
-  local stressLineSize=$(($(random_between 2 10) ** 2))
-  echo "stressLineSize=$stressLineSize" >> $PARAM_FILE
-  local stressTargetLines=$(random_between 1 16)
-  echo "stressTargetLines=$stressTargetLines" >> $PARAM_FILE
-  echo "scratchMemorySize=$((32 * $stressLineSize * $stressTargetLines))" >> $PARAM_FILE
-  echo "memStride=$(random_between 1 7)" >> $PARAM_FILE
-  echo "memStressPct=$(random_between 0 100)" >> $PARAM_FILE
-  echo "memStressIterations=$(random_between 0 1024)" >> $PARAM_FILE
-  echo "memStressPattern=$(random_between 0 3)" >> $PARAM_FILE
-  echo "preStressPct=$(random_between 0 100)" >> $PARAM_FILE
-  echo "preStressIterations=$(random_between 0 128)" >> $PARAM_FILE
-  echo "preStressPattern=$(random_between 0 3)" >> $PARAM_FILE
-  echo "stressAssignmentStrategy=$(random_between 0 1)" >> $PARAM_FILE
-  echo "permuteThread=419" >> $PARAM_FILE
+# Generate the next config for a memory type from the low-discrepancy sequence tracked in its coverage file
+function generate_config() {
+  local test_mem=$1
+
+  ./runner -g "$RESULT_DIR/coverage-$device_idx-$test_mem.txt" -D $PROFILE_FILE -p $PARAM_FILE -t rr-$test_mem-params.txt > /dev/null
 }
 
 function run_test() {
   local test=$1
   local test_mem=$2
   local test_scope=$3
-  res=$(./runner -n $test -s $test-$test_mem-$test_scope.spv -r $test-results.spv -p $PARAM_FILE -t $test-$test_mem-params.txt -d $device_idx)
+  # the runner exits nonzero without running the test if the config exceeds the device's limits or needs a feature
+  # the device does not support
+  if ! res=$(./runner -n $test -s $test-$test_mem-$test_scope.spv -r $test-results.spv -p $PARAM_FILE -t $test-$test_mem-params.txt -d $device_idx ${AGGREGATE:+-m $AGGREGATE}) ; then
+    echo "  Test $test-$test_mem-$test_scope skipped"
+    return
+  fi
   local device_used=$(echo "$res" | head -n 1 | sed 's/.*Using device \(.*\)$/\1/')
   local num_violations=$(echo "$res" | tail -n 1 | sed 's/.*of violations: \(.*\)$/\1/')
   echo "  Test $test-$test_mem-$test_scope violations: $num_violations"
@@ -75,6 +73,15 @@ if [ ! -d "$RESULT_DIR" ] ; then
   mkdir $RESULT_DIR
 fi
 
+PROFILE_FILE="$RESULT_DIR/profile-$device_idx.txt"
+if [ ! -f "$PROFILE_FILE" ] ; then
+  if ! calibrate ; then
+    echo "Calibration failed"
+    rm -f "$PROFILE_FILE"
+    exit 1
+  fi
+fi
+
 test_names=("rr" "rw" "wr")
 iter=0
 
@@ -82,15 +89,21 @@ while [ true ]
 do
   echo "Iteration: $iter"
 
-  # device memory tests
-  random_config 1024 256
+  # device memory tests; without a new config, params.txt would still hold the last one, so stop instead
+  if ! generate_config mem-device ; then
+    echo "Config generation failed"
+    exit 1
+  fi
   for test in "${test_names[@]}"; do
     run_test "$test" "mem-device" "scope-device"
     run_test "$test" "mem-device" "scope-wg"
   done
 
   # workgroup memory tests
-  random_config 16 128 
+  if ! generate_config mem-wg ; then
+    echo "Config generation failed"
+    exit 1
+  fi
   for test in "${test_names[@]}"; do
     run_test "$test" "mem-wg" "scope-wg"
   done